@@ -10,4 +10,9 @@ RAYLIB_FLAGS=$(pkg-config --libs --cflags raylib)
 $CC $CFLAGS -shared src/game.c -o build/game.so.tmp $RAYLIB_FLAGS
 mv build/game.so.tmp build/game.so
 
-$CC $CFLAGS src/main.c -o build/main $RAYLIB_FLAGS -ldl
+$CC $CFLAGS src/main.c -o build/main $RAYLIB_FLAGS -ldl -lpthread
+
+$CC $CFLAGS src/batch.c -o build/batch $RAYLIB_FLAGS -lpthread
+
+$CC $CFLAGS src/collision_test.c -o build/collision_test $RAYLIB_FLAGS
+./build/collision_test
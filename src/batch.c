@@ -0,0 +1,297 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "game.c"
+#include "posix_platform.h"
+
+#define BATCH_DT (1.0f / 60.0f)
+#define BATCH_STORAGE_SIZE MB(64)
+#define MAX_BATCH_WORKERS 256
+
+typedef struct {
+    usize run_count;
+    f32 max_time;
+    u64 base_seed;
+    b32 has_seed;
+    const char *input_path;
+} batch_config;
+
+typedef struct {
+    usize run_index;
+    u64 seed;
+
+    f32 survival_time;
+    usize kills;
+    usize peak_entity_count;
+    u64 frames;
+    f64 mean_frame_us;
+    f64 max_frame_us;
+} batch_result;
+
+typedef struct {
+    batch_config *config;
+    batch_result *results;
+    _Atomic usize next_run;
+} batch_context;
+
+typedef struct {
+    batch_context *context;
+    usize cpu;
+} batch_worker;
+
+internal void
+ScriptedPolicy(game_state *state, game_input *input)
+{
+    f32 angle = state->time * 0.5f;
+    f32 threshold = 0.3f;
+    input->action_right = cosf(angle) > threshold;
+    input->action_left = cosf(angle) < -threshold;
+    input->action_down = sinf(angle) > threshold;
+    input->action_up = sinf(angle) < -threshold;
+
+    Vector2 player_pos = state->positions[state->player_index].value;
+    f32 best_distance_sq = 0.0f;
+    b32 has_target = false;
+    Vector2 target = player_pos;
+
+    for (usize i = 0; i < state->entity_count; ++i) {
+        if (state->entities[i].tag != Tag_Enemy) {
+            continue;
+        }
+
+        f32 distance_sq = Vector2DistanceSqr(player_pos, state->positions[i].value);
+        if (!has_target || distance_sq < best_distance_sq) {
+            best_distance_sq = distance_sq;
+            target = state->positions[i].value;
+            has_target = true;
+        }
+    }
+
+    input->action_shoot = has_target;
+    input->mouse_pos = GetWorldToScreen2D(target, state->camera);
+}
+
+internal void
+RunSession(batch_config *config, platform_memory *memory, batch_result *result)
+{
+    game_state *state = (game_state *)memory->permanent_storage;
+    if (state->is_initialized) {
+        ZeroSize(state->world_arena.used, state->world_arena.base);
+    }
+    ZeroSize(sizeof(*state), state);
+
+    input_replay replay = { 0 };
+    if (config->input_path) {
+        u64 recorded_seed;
+        if (!BeginPlayback(&replay, config->input_path, &recorded_seed)) {
+            return;
+        }
+
+        if (!config->has_seed) {
+            result->seed = recorded_seed;
+        }
+    }
+
+    memory->random_seed = result->seed;
+
+    game_input input = {
+        .dt = BATCH_DT,
+        .screen_size = { 1280.0f, 720.0f },
+    };
+
+    f64 total_frame_time = 0.0;
+    while (state->time < config->max_time) {
+        if (replay.mode == Replay_Playback) {
+            if (!PlayBackInput(&replay, &input)) {
+                break;
+            }
+        } else if (state->is_initialized) {
+            ScriptedPolicy(state, &input);
+        }
+
+        f64 start = GetWallClock();
+        GameUpdate(memory, &input, NULL);
+        f64 frame_us = (GetWallClock() - start) * 1e6;
+        input.frame_cost = (f32)(frame_us * 1e-6);
+
+        total_frame_time += frame_us;
+        result->max_frame_us = Max(result->max_frame_us, frame_us);
+        result->frames += 1;
+
+        usize live_count = state->entity_count + state->projectile_count;
+        result->peak_entity_count = Max(result->peak_entity_count, live_count);
+
+        if (state->mode == GameMode_Gameover) {
+            break;
+        }
+    }
+
+    result->survival_time = state->time;
+    result->kills = state->kill_count;
+    result->mean_frame_us = result->frames ? total_frame_time / (f64)result->frames : 0.0;
+
+    if (replay.file) {
+        fclose(replay.file);
+    }
+}
+
+internal void *
+BatchWorker(void *param)
+{
+    batch_worker *worker = (batch_worker *)param;
+    batch_context *context = worker->context;
+
+    // Pin before allocating so the pages are first touched on this core's node.
+#if defined(__linux__)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(worker->cpu, &cpus);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (error) {
+        fprintf(stderr,
+                "batch: could not pin worker to cpu %zu: %s\n",
+                worker->cpu,
+                strerror(error));
+    }
+#endif
+
+    platform_memory memory = { 0 };
+    memory.permanent_storage_size = BATCH_STORAGE_SIZE;
+    memory.permanent_storage = AllocateMemory(memory.permanent_storage_size);
+    memory.platform = Platform;
+
+    if (!memory.permanent_storage) {
+        fprintf(stderr, "batch: worker %zu could not allocate its storage\n", worker->cpu);
+        return NULL;
+    }
+
+    for (;;) {
+        usize run = atomic_fetch_add(&context->next_run, 1);
+        if (run >= context->config->run_count) {
+            break;
+        }
+
+        batch_result *result = &context->results[run];
+        result->run_index = run;
+        result->seed = context->config->base_seed + run;
+
+        RunSession(context->config, &memory, result);
+    }
+
+    DeallocateMemory(memory.permanent_storage, memory.permanent_storage_size);
+
+    return NULL;
+}
+
+int
+main(int argc, char **argv)
+{
+    batch_config config = {
+        .run_count = 64,
+        .max_time = 600.0f,
+        .base_seed = 1,
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--runs") == 0 && value) {
+            config.run_count = strtoull(value, NULL, 10);
+            i += 1;
+        } else if (strcmp(argv[i], "--max-time") == 0 && value) {
+            config.max_time = strtof(value, NULL);
+            i += 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && value) {
+            config.base_seed = strtoull(value, NULL, 10);
+            config.has_seed = true;
+            i += 1;
+        } else if (strcmp(argv[i], "--input") == 0 && value) {
+            config.input_path = value;
+            i += 1;
+        } else {
+            fprintf(stderr,
+                    "usage: %s [--runs N] [--max-time SECONDS] [--seed N] [--input RECORDING]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    // Workers go on the CPUs this process may run on, which under taskset or a cpuset
+    // aren't necessarily 0..n-1.
+    usize cpu_count = 0;
+    usize cpus[MAX_BATCH_WORKERS];
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        for (usize cpu = 0; cpu < CPU_SETSIZE && cpu_count < MAX_BATCH_WORKERS; ++cpu) {
+            if (CPU_ISSET(cpu, &allowed)) {
+                cpus[cpu_count++] = cpu;
+            }
+        }
+    } else {
+        perror("batch: sched_getaffinity");
+    }
+#endif
+    if (!cpu_count) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        cpu_count = Min((usize)Max(online, 1), (usize)MAX_BATCH_WORKERS);
+        for (usize cpu = 0; cpu < cpu_count; ++cpu) {
+            cpus[cpu] = cpu;
+        }
+    }
+
+    usize worker_count = Min(cpu_count, Max(config.run_count, (usize)1));
+
+    Platform.AllocateMemory = AllocateMemory;
+    Platform.DeallocateMemory = DeallocateMemory;
+    Platform.allocation_granularity = GetAllocationGranularity();
+
+    batch_context context = { 0 };
+    context.config = &config;
+    context.results = (batch_result *)calloc(config.run_count, sizeof(*context.results));
+
+    batch_worker *workers = (batch_worker *)calloc(worker_count, sizeof(*workers));
+    pthread_t *threads = (pthread_t *)calloc(worker_count, sizeof(*threads));
+
+    fprintf(stderr, "batch: %zu runs on %zu workers\n", config.run_count, worker_count);
+
+    for (usize i = 0; i < worker_count; ++i) {
+        workers[i].context = &context;
+        workers[i].cpu = cpus[i];
+        pthread_create(&threads[i], NULL, BatchWorker, &workers[i]);
+    }
+
+    for (usize i = 0; i < worker_count; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("run,seed,survival_time,kills,peak_entities,frames,mean_frame_us,max_frame_us\n");
+    for (usize i = 0; i < config.run_count; ++i) {
+        batch_result *r = &context.results[i];
+        printf("%zu,%llu,%.2f,%zu,%zu,%llu,%.2f,%.2f\n",
+               r->run_index,
+               (unsigned long long)r->seed,
+               r->survival_time,
+               r->kills,
+               r->peak_entity_count,
+               (unsigned long long)r->frames,
+               r->mean_frame_us,
+               r->max_frame_us);
+    }
+
+    free(threads);
+    free(workers);
+    free(context.results);
+
+    return 0;
+}
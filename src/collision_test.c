@@ -0,0 +1,141 @@
+#include "game.c"
+
+#define RANDOM_ITERATIONS Thousand(100)
+
+typedef struct {
+    usize checked;
+    usize mismatches;
+} test_result;
+
+internal f32
+RandomFloat(u64 *series, f32 min, f32 max)
+{
+    return min + (max - min) * ((f32)NextRandom(series) / (f32)0xFFFFFFFFu);
+}
+
+internal void
+CheckMask(test_result *result,
+          const char *kernel,
+          u32 mask,
+          Vector2 center,
+          f32 radius,
+          const f32 *xs,
+          const f32 *ys,
+          const f32 *radii,
+          usize count)
+{
+    for (usize i = 0; i < CIRCLE_BATCH_WIDTH; ++i) {
+        b32 got = (mask >> i) & 1;
+        b32 expected = false;
+        if (i < count) {
+            expected = CheckCollisionCircles(center, radius, (Vector2){ xs[i], ys[i] }, radii[i]);
+        }
+
+        result->checked += 1;
+        if (got != expected) {
+            result->mismatches += 1;
+            fprintf(stderr,
+                    "mismatch: %s count %zu bit %zu center (%g, %g) r %g circle (%g, %g) r %g: "
+                    "got %d expected %d\n",
+                    kernel,
+                    count,
+                    i,
+                    center.x,
+                    center.y,
+                    radius,
+                    i < count ? xs[i] : 0.0f,
+                    i < count ? ys[i] : 0.0f,
+                    i < count ? radii[i] : 0.0f,
+                    got,
+                    expected);
+        }
+    }
+}
+
+internal void
+CheckBatch(test_result *result,
+           Vector2 center,
+           f32 radius,
+           const f32 *xs,
+           const f32 *ys,
+           const f32 *radii,
+           usize count)
+{
+    u32 scalar = CheckCollisionCirclesBatchScalar(center, radius, xs, ys, radii, count);
+    CheckMask(result, "scalar", scalar, center, radius, xs, ys, radii, count);
+
+    u32 batch = CheckCollisionCirclesBatch(center, radius, xs, ys, radii, count);
+    CheckMask(result, "batch", batch, center, radius, xs, ys, radii, count);
+}
+
+internal void
+TestRandomCircles(test_result *result, u64 *series)
+{
+    f32 xs[CIRCLE_BATCH_WIDTH];
+    f32 ys[CIRCLE_BATCH_WIDTH];
+    f32 radii[CIRCLE_BATCH_WIDTH];
+
+    for (usize iteration = 0; iteration < RANDOM_ITERATIONS; ++iteration) {
+        usize count = 1 + iteration % CIRCLE_BATCH_WIDTH;
+
+        Vector2 center = { RandomFloat(series, -200.0f, 200.0f),
+                           RandomFloat(series, -200.0f, 200.0f) };
+        f32 radius = RandomFloat(series, 1.0f, 50.0f);
+
+        for (usize i = 0; i < count; ++i) {
+            xs[i] = center.x + RandomFloat(series, -120.0f, 120.0f);
+            ys[i] = center.y + RandomFloat(series, -120.0f, 120.0f);
+            radii[i] = RandomFloat(series, 1.0f, 50.0f);
+        }
+
+        CheckBatch(result, center, radius, xs, ys, radii, count);
+    }
+}
+
+// Circles that exactly touch: offsets from 3-4-5 triangles, so the distance and the
+// radius sum are both exact in f32.
+internal void
+TestTouchingCircles(test_result *result, u64 *series)
+{
+    f32 xs[CIRCLE_BATCH_WIDTH];
+    f32 ys[CIRCLE_BATCH_WIDTH];
+    f32 radii[CIRCLE_BATCH_WIDTH];
+
+    for (usize count = 1; count <= CIRCLE_BATCH_WIDTH; ++count) {
+        for (i32 scale = 1; scale <= 64; ++scale) {
+            Vector2 center = { (f32)RandomRange(series, -500, 500),
+                               (f32)RandomRange(series, -500, 500) };
+            f32 distance = 5.0f * (f32)scale;
+            f32 radius = (f32)RandomRange(series, 1, 5 * scale - 2);
+
+            for (usize i = 0; i < count; ++i) {
+                f32 sign_x = (i & 1) ? -1.0f : 1.0f;
+                f32 sign_y = (i & 2) ? -1.0f : 1.0f;
+                b32 swap = (i & 4) != 0;
+
+                f32 dx = 3.0f * (f32)scale * sign_x;
+                f32 dy = 4.0f * (f32)scale * sign_y;
+                xs[i] = center.x + (swap ? dy : dx);
+                ys[i] = center.y + (swap ? dx : dy);
+
+                radii[i] = distance - radius - ((i % 3 == 2) ? 1.0f : 0.0f);
+            }
+
+            CheckBatch(result, center, radius, xs, ys, radii, count);
+        }
+    }
+}
+
+int
+main(void)
+{
+    u64 series = 0x9E3779B97F4A7C15ull;
+    test_result result = { 0 };
+
+    TestRandomCircles(&result, &series);
+    TestTouchingCircles(&result, &series);
+
+    printf("collision_test: %zu bits checked, %zu mismatches\n", result.checked, result.mismatches);
+
+    return result.mismatches ? 1 : 0;
+}
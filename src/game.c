@@ -1,24 +1,130 @@
 #include "raylib.h"
 #include "raymath.h"
 
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
 #include "base_types.h"
 #include "game.h"
 
+// clang-format off
+global_const entity_prototype Prototypes[Proto_Count] = {
+    [Proto_Player] = {
+        .color       = { 0, 121, 241, 255 },   // BLUE
+        .flash_color = { 230, 41, 55, 255 },   // RED
+        .radius      = 30.0f,
+        .max_health  = 100.0f,
+        .speed       = 200.0f,
+    },
+    [Proto_Enemy] = {
+        .color       = { 230, 41, 55, 255 },   // RED
+        .flash_color = { 255, 255, 255, 255 }, // WHITE
+        .radius      = 20.0f,
+        .max_health  = 100.0f,
+        .damage      = 10.0f,
+        .speed       = 100.0f,
+        .max_speed   = 500.0f,
+    },
+    [Proto_Projectile] = {
+        .radius      = 5.0f,
+        .damage      = 20.0f,
+        .speed       = 800.0f,
+    },
+};
+// clang-format on
+
+internal inline u32
+NextRandom(u64 *series)
+{
+    u64 x = *series;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *series = x;
+
+    return (u32)((x * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+internal inline i32
+RandomRange(u64 *series, i32 min, i32 max)
+{
+    return min + (i32)(NextRandom(series) % (u32)(max - min + 1));
+}
+
+internal inline const entity_prototype *
+GetPrototype(game_state *state, usize idx)
+{
+    return &Prototypes[state->entities[idx].prototype];
+}
+
+internal f32
+GetHeldFraction(game_input *input, input_action action, b32 is_down_at_end)
+{
+    b32 is_down = is_down_at_end;
+    for (u32 i = 0; i < input->event_count; ++i) {
+        if (input->events[i].action == action) {
+            is_down = !input->events[i].is_down;
+            break;
+        }
+    }
+
+    if (input->dt <= 0.0f) {
+        return is_down_at_end ? 1.0f : 0.0f;
+    }
+
+    f32 held = 0.0f;
+    f32 last_time = 0.0f;
+    for (u32 i = 0; i < input->event_count; ++i) {
+        input_event event = input->events[i];
+        if (event.action != action) {
+            continue;
+        }
+
+        if (is_down) {
+            held += event.time - last_time;
+        }
+        last_time = event.time;
+        is_down = event.is_down;
+    }
+
+    if (is_down) {
+        held += input->dt - last_time;
+    }
+
+    return Clamp(held / input->dt, 0.0f, 1.0f);
+}
+
+internal b32
+WasActionPressed(game_input *input, input_action action)
+{
+    for (u32 i = 0; i < input->event_count; ++i) {
+        if (input->events[i].action == action && input->events[i].is_down) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
 internal void
 EmitDisintegrate(game_state *state, Vector2 pos, Color color, f32 radius)
 {
     local_const usize particles_count = ArrayCount(state->particles);
 
-    for (usize i = 0; i < (usize)radius; ++i) {
+    f32 quality = state->effects.quality;
+    usize emit_count = Max((usize)(radius * quality), (usize)1);
+
+    for (usize i = 0; i < emit_count; ++i) {
         particle *p = &state->particles[state->next_particle];
 
         p->pos = pos;
 
-        f32 angle = (f32)GetRandomValue(0, 360) * DEG2RAD;
-        f32 speed = (f32)GetRandomValue(50, 150);
+        f32 angle = (f32)RandomRange(&state->effects_random_state, 0, 360) * DEG2RAD;
+        f32 speed = (f32)RandomRange(&state->effects_random_state, 50, 150);
         p->velocity = (Vector2){ cosf(angle) * speed, sinf(angle) * speed };
 
-        p->life = 2.0f;
+        p->life = 2.0f * quality;
         p->color = color;
         p->radius = radius * 0.1f;
 
@@ -26,6 +132,23 @@ EmitDisintegrate(game_state *state, Vector2 pos, Color color, f32 radius)
     }
 }
 
+internal void
+EffectsGovernorSystem(game_state *state, game_input *input)
+{
+    effects_governor *governor = &state->effects;
+
+    f32 smoothing = 0.1f;
+    governor->average_cost = Lerp(governor->average_cost, input->frame_cost, smoothing);
+
+    if (governor->average_cost > FRAME_BUDGET * 0.9f) {
+        governor->quality -= 2.0f * input->dt;
+    } else if (governor->average_cost < FRAME_BUDGET * 0.6f) {
+        governor->quality += 0.5f * input->dt;
+    }
+
+    governor->quality = Clamp(governor->quality, MIN_EFFECTS_QUALITY, 1.0f);
+}
+
 internal void
 UpdateParticles(game_state *state, game_input *input)
 {
@@ -42,36 +165,76 @@ UpdateParticles(game_state *state, game_input *input)
     }
 }
 
+internal inline void
+PushRenderCircle(render_snapshot *snapshot, Vector2 pos, f32 radius, Color color)
+{
+    Assert(snapshot->circle_count < ArrayCount(snapshot->circles));
+    snapshot->circles[snapshot->circle_count++] = (render_circle){ pos, radius, color };
+}
+
 internal void
-RenderParticles(game_state *state)
+RenderParticles(game_state *state, render_snapshot *snapshot)
 {
     usize count = ArrayCount(state->particles);
     for (usize i = 0; i < count; ++i) {
         particle p = state->particles[i];
         if (p.life > 0) {
-            DrawCircleV(p.pos, p.life, p.color);
+            PushRenderCircle(snapshot, p.pos, p.life, p.color);
         }
     }
 }
 
+internal void
+MarkDamaged(game_state *state, usize idx)
+{
+    entity *e = &state->entities[idx];
+    if (HasFlag(e->components, Comp_Damaged)) {
+        return;
+    }
+
+    AddFlag(e->components, Comp_Damaged);
+    state->damaged[state->damaged_count++] = (u32)idx;
+}
+
+internal void
+StartFlash(game_state *state, usize idx, f32 duration)
+{
+    entity *e = &state->entities[idx];
+    if (HasFlag(e->components, Comp_Flash)) {
+        for (usize i = 0; i < state->flash_count; ++i) {
+            if (state->flashes[i].entity == idx) {
+                state->flashes[i].timer = duration;
+                break;
+            }
+        }
+        return;
+    }
+
+    if (state->flash_count < ArrayCount(state->flashes)) {
+        AddFlag(e->components, Comp_Flash);
+        state->flashes[state->flash_count++] =
+            (flash_effect){ .entity = (u32)idx, .timer = duration };
+    }
+}
+
 internal void
 OnEnemyHit(game_state *state, usize idx)
 {
-    state->healths[idx].value -= 20.0f;
-    state->renderables[idx].flash_timer = 0.1f;
-    state->renderables[idx].flash_color = WHITE;
+    state->healths[idx].value -= Prototypes[Proto_Projectile].damage;
+    MarkDamaged(state, idx);
+    StartFlash(state, idx, 0.1f);
 }
 
 internal void
 OnPlayerHit(game_state *state, usize idx)
 {
-    state->healths[idx].value -= 10.0f;
-    state->renderables[idx].flash_timer = 0.1f;
-    state->renderables[idx].flash_color = RED;
+    state->healths[idx].value -= Prototypes[Proto_Enemy].damage;
+    MarkDamaged(state, idx);
+    StartFlash(state, idx, 0.1f);
 }
 
 internal void
-SpawnPlayer(game_state *state)
+SpawnPlayer(game_state *state, game_input *input)
 {
     usize idx = state->entity_count++;
     Assert(idx < ArrayCount(state->entities));
@@ -79,54 +242,79 @@ SpawnPlayer(game_state *state)
     state->player_index = idx;
     state->entities[idx].components = Comp_Position | Comp_Velocity | Comp_Render | Comp_Health;
     state->entities[idx].tag = Tag_Player;
+    state->entities[idx].prototype = Proto_Player;
 
-    state->positions[idx].value =
-        (Vector2){ (f32)GetScreenWidth() / 2.0f, (f32)GetScreenHeight() / 2.0f };
+    state->positions[idx].value = Vector2Scale(input->screen_size, 0.5f);
     state->velocities[idx].value = Vector2Zero();
-    state->renderables[idx].color = BLUE;
-    state->renderables[idx].radius = 30;
-    state->healths[idx].value = 100.0f;
+    state->healths[idx].value = Prototypes[Proto_Player].max_health;
 }
 
-internal void
-SpawnEnemy(game_state *state, Vector2 pos)
+// The count is clamped to what is left.
+internal usize
+ReserveEntities(game_state *state, usize *count)
 {
-    usize idx = state->entity_count++;
-    Assert(idx < ArrayCount(state->entities));
+    usize available = ArrayCount(state->entities) - state->entity_count;
+    *count = Min(*count, available);
 
-    state->entities[idx].components = Comp_Position | Comp_Velocity | Comp_Render | Comp_Health;
-    state->entities[idx].tag = Tag_Enemy;
+    usize first = state->entity_count;
+    state->entity_count += *count;
 
-    state->positions[idx].value = pos;
-    state->renderables[idx].color = RED;
-    state->renderables[idx].radius = 20;
-    state->renderables[idx].flash_color = WHITE;
-    state->healths[idx].value = 100.0f;
+    return first;
+}
 
-    Vector2 diff =
-        Vector2Subtract(state->positions[state->player_index].value, state->positions[idx].value);
+internal void
+SpawnEnemies(game_state *state, usize count, f32 ring_radius)
+{
+    usize first = ReserveEntities(state, &count);
+    usize end = first + count;
+
+    const entity_prototype *proto = &Prototypes[Proto_Enemy];
+    Vector2 center = state->positions[state->player_index].value;
+
+    for (usize i = first; i < end; ++i) {
+        state->entities[i] = (entity){
+            .components = Comp_Position | Comp_Velocity | Comp_Render | Comp_Health,
+            .tag = Tag_Enemy,
+            .prototype = Proto_Enemy,
+        };
+    }
+
+    for (usize i = first; i < end; ++i) {
+        f32 angle = (f32)RandomRange(&state->random_state, 0, 360) * DEG2RAD;
+        Vector2 direction = { cosf(angle), sinf(angle) };
 
-    f32 speed = 100.0f;
-    state->velocities[idx].value = Vector2Scale(Vector2Normalize(diff), speed);
+        state->positions[i].value = Vector2Add(center, Vector2Scale(direction, ring_radius));
+        state->velocities[i].value = Vector2Scale(direction, -proto->speed);
+    }
+
+    for (usize i = first; i < end; ++i) {
+        state->healths[i].value = proto->max_health;
+    }
 }
 
 internal void
 SpawnProjectile(game_state *state, Vector2 target)
 {
-    usize idx = state->entity_count++;
-    Assert(idx < ArrayCount(state->entities));
+    if (state->projectile_count >= ArrayCount(state->projectiles)) {
+        return;
+    }
 
-    state->entities[idx].components = Comp_Position | Comp_Velocity | Comp_Render;
-    state->entities[idx].tag = Tag_Projectile;
+    projectile *p = &state->projectiles[state->projectile_count++];
 
-    state->positions[idx].value = state->positions[state->player_index].value;
-    state->renderables[idx].color = state->renderables[state->player_index].color;
-    state->renderables[idx].radius = 5;
+    p->pos = state->positions[state->player_index].value;
+    p->color = GetPrototype(state, state->player_index)->color;
 
-    Vector2 diff = Vector2Subtract(target, state->positions[state->player_index].value);
+    Vector2 diff = Vector2Subtract(target, p->pos);
 
-    f32 speed = 800.0f;
-    state->velocities[idx].value = Vector2Scale(Vector2Normalize(diff), speed);
+    f32 speed = Prototypes[Proto_Projectile].speed;
+    p->velocity = Vector2Scale(Vector2Normalize(diff), speed);
+}
+
+internal void
+FreeProjectile(game_state *state, usize idx)
+{
+    Assert(idx < state->projectile_count);
+    state->projectiles[idx] = state->projectiles[--state->projectile_count];
 }
 
 internal void
@@ -146,19 +334,13 @@ SpawnSystem(game_state *state, game_input *input)
 
         usize spawn_count = 3 + ((usize)state->time / 60.0f);
 
-        for (usize i = 0; i < spawn_count; ++i) {
-            Vector2 center = state->positions[state->player_index].value;
-
-            f32 angle = (f32)GetRandomValue(0, 360) * DEG2RAD;
-            f32 radius = 700.0f;
-            Vector2 spawn_pos = { center.x + cosf(angle) * radius,
-                center.y + sinf(angle) * radius };
+        f32 radius = 700.0f;
 
-            SpawnEnemy(state, spawn_pos);
-        }
+        SpawnEnemies(state, spawn_count, radius);
     }
 
-    if (input->action_shoot && state->projectile_spawn_timer >= 0.05f) {
+    b32 shoot = input->action_shoot || WasActionPressed(input, Action_Shoot);
+    if (shoot && state->projectile_spawn_timer >= 0.05f) {
         state->projectile_spawn_timer = 0.0f;
 
         Vector2 world_mouse = GetScreenToWorld2D(input->mouse_pos, state->camera);
@@ -169,26 +351,54 @@ SpawnSystem(game_state *state, game_input *input)
 internal void
 DespawnSystem(game_state *state)
 {
-    usize write_idx = 0;
-    for (usize read_idx = 0; read_idx < state->entity_count; ++read_idx) {
-        if (state->entities[read_idx].tag == Tag_Dead) {
-            continue;
+    temporary_memory temp = BeginTemporaryMemory(&state->world_arena);
+    u32 *keep = PushArray(&state->world_arena, state->entity_count, u32);
+    u32 *remap = PushArray(&state->world_arena, state->entity_count, u32);
+
+    usize keep_count = 0;
+    for (usize i = 0; i < state->entity_count; ++i) {
+        if (i == state->player_index) {
+            state->player_index = keep_count;
         }
 
-        if (write_idx != read_idx) {
-            state->entities[write_idx] = state->entities[read_idx];
-#define X(type, name) state->name[write_idx] = state->name[read_idx];
-            COMPONENT_LIST
-            #undef X
+        remap[i] = (u32)keep_count;
+        keep[keep_count] = (u32)i;
+        keep_count += (state->entities[i].tag != Tag_Dead);
+    }
 
-            if (read_idx == state->player_index) {
-                state->player_index = write_idx;
-            }
+    // Before the gather, while the tags are still at the old indices.
+    usize flash_count = 0;
+    for (usize i = 0; i < state->flash_count; ++i) {
+        flash_effect flash = state->flashes[i];
+        if (state->entities[flash.entity].tag == Tag_Dead) {
+            continue;
         }
-        write_idx += 1;
+
+        flash.entity = remap[flash.entity];
+        state->flashes[flash_count++] = flash;
     }
+    state->flash_count = flash_count;
 
-    state->entity_count = write_idx;
+    // keep[i] >= i, so each stream can be gathered forward in place.
+    usize first = 0;
+    while (first < keep_count && keep[first] == first) {
+        first += 1;
+    }
+
+    for (usize i = first; i < keep_count; ++i) {
+        state->entities[i] = state->entities[keep[i]];
+    }
+
+#define X(type, name)                            \
+    for (usize i = first; i < keep_count; ++i) { \
+        state->name[i] = state->name[keep[i]];   \
+    }
+    COMPONENT_LIST
+#undef X
+
+    state->entity_count = keep_count;
+
+    EndTemporaryMemory(temp);
 }
 
 internal void
@@ -224,78 +434,260 @@ EnemyAISystem(game_state *state)
         velocity *vel = &state->velocities[i];
 
         Vector2 dir = Vector2Normalize(Vector2Subtract(player_pos, pos.value));
-        f32 min_speed = 100.0f;
-        f32 max_speed = 500.0f;
+        f32 min_speed = Prototypes[Proto_Enemy].speed;
+        f32 max_speed = Prototypes[Proto_Enemy].max_speed;
 
         f32 speed = Lerp(min_speed, max_speed, Clamp(state->time / 300.0f, 0.0f, 1.0f));
         vel->value = Vector2Scale(dir, speed);
     }
 }
 
-internal void
-PlayerEnemyCollisionSystem(game_state *state)
+#define CIRCLE_BATCH_WIDTH 8
+
+typedef struct {
+    f32 *x;
+    f32 *y;
+    f32 *radius;
+    usize *index;
+    usize count;
+} circle_batch;
+
+[[maybe_unused]] internal u32
+CheckCollisionCirclesBatchScalar(
+    Vector2 center, f32 radius, const f32 *xs, const f32 *ys, const f32 *radii, usize count)
 {
-    for (usize enemy_idx = 0; enemy_idx < state->entity_count; ++enemy_idx) {
-        if (!HasFlags(state->entities[enemy_idx].components, Comp_Position | Comp_Render) ||
-            state->entities[enemy_idx].tag != Tag_Enemy) {
+    Assert(count <= CIRCLE_BATCH_WIDTH);
+
+    u32 result = 0;
+    for (usize i = 0; i < count; ++i) {
+        f32 dx = xs[i] - center.x;
+        f32 dy = ys[i] - center.y;
+        f32 r = radius + radii[i];
+
+        if (dx * dx + dy * dy <= r * r) {
+            result |= (1u << i);
+        }
+    }
+
+    return result;
+}
+
+internal u32
+CheckCollisionCirclesBatch(
+    Vector2 center, f32 radius, const f32 *xs, const f32 *ys, const f32 *radii, usize count)
+{
+#if defined(__SSE__)
+    Assert(count <= CIRCLE_BATCH_WIDTH);
+
+    f32 lane_x[CIRCLE_BATCH_WIDTH] = { 0 };
+    f32 lane_y[CIRCLE_BATCH_WIDTH] = { 0 };
+    f32 lane_r[CIRCLE_BATCH_WIDTH] = { 0 };
+    for (usize i = 0; i < count; ++i) {
+        lane_x[i] = xs[i];
+        lane_y[i] = ys[i];
+        lane_r[i] = radii[i];
+    }
+
+    __m128 cx = _mm_set1_ps(center.x);
+    __m128 cy = _mm_set1_ps(center.y);
+    __m128 cr = _mm_set1_ps(radius);
+
+    u32 result = 0;
+    for (usize lane = 0; lane < CIRCLE_BATCH_WIDTH; lane += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(lane_x + lane), cx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(lane_y + lane), cy);
+        __m128 r = _mm_add_ps(_mm_loadu_ps(lane_r + lane), cr);
+
+        __m128 distance_sq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        __m128 hit = _mm_cmple_ps(distance_sq, _mm_mul_ps(r, r));
+
+        result |= (u32)_mm_movemask_ps(hit) << lane;
+    }
+
+    result &= (u32)((1u << count) - 1);
+
+    Assert(result == CheckCollisionCirclesBatchScalar(center, radius, xs, ys, radii, count));
+
+    return result;
+#else
+    return CheckCollisionCirclesBatchScalar(center, radius, xs, ys, radii, count);
+#endif
+}
+
+internal circle_batch
+GatherEnemyCircles(game_state *state, memory_arena *arena, f32 inflate_dt)
+{
+    circle_batch result = { 0 };
+    result.x = PushArray(arena, state->entity_count, f32);
+    result.y = PushArray(arena, state->entity_count, f32);
+    result.radius = PushArray(arena, state->entity_count, f32);
+    result.index = PushArray(arena, state->entity_count, usize);
+
+    for (usize i = 0; i < state->entity_count; ++i) {
+        if (!HasFlags(state->entities[i].components, Comp_Position | Comp_Render) ||
+            state->entities[i].tag != Tag_Enemy) {
             continue;
         }
 
-        position player_pos = state->positions[state->player_index];
-        position entity_pos = state->positions[enemy_idx];
+        usize n = result.count++;
+        result.x[n] = state->positions[i].value.x;
+        result.y[n] = state->positions[i].value.y;
+        result.radius[n] = GetPrototype(state, i)->radius +
+                           Vector2Length(state->velocities[i].value) * inflate_dt;
+        result.index[n] = i;
+    }
 
-        renderable player_r = state->renderables[state->player_index];
-        renderable entity_r = state->renderables[enemy_idx];
+    return result;
+}
 
-        if (CheckCollisionCircles(
-            player_pos.value, player_r.radius, entity_pos.value, entity_r.radius)) {
+internal void
+PlayerEnemyCollisionSystem(game_state *state)
+{
+    temporary_memory temp = BeginTemporaryMemory(&state->world_arena);
+    circle_batch enemies = GatherEnemyCircles(state, &state->world_arena, 0.0f);
+
+    position player_pos = state->positions[state->player_index];
+    f32 player_radius = GetPrototype(state, state->player_index)->radius;
+
+    for (usize base = 0; base < enemies.count; base += CIRCLE_BATCH_WIDTH) {
+        usize count = Min(enemies.count - base, CIRCLE_BATCH_WIDTH);
+        u32 hits = CheckCollisionCirclesBatch(player_pos.value,
+                                              player_radius,
+                                              enemies.x + base,
+                                              enemies.y + base,
+                                              enemies.radius + base,
+                                              count);
+
+        while (hits) {
+            u32 lane = (u32)__builtin_ctz(hits);
+            hits &= hits - 1;
+
+            usize enemy_idx = enemies.index[base + lane];
             state->entities[enemy_idx].tag = Tag_Dead;
             AddFlag(state->entities[state->player_index].components, Comp_Collision);
 
             OnPlayerHit(state, state->player_index);
         }
     }
+
+    EndTemporaryMemory(temp);
 }
 
-internal void
-ProjectileCollisionSystem(game_state *state)
+// Tested in the target's frame: hits when the mover's relative path passes within the
+// sum of the radii. t_hit is the fraction of the step at first contact.
+internal b32
+CheckCollisionSweptCircles(
+    Vector2 start, Vector2 end, f32 radius, Vector2 center, f32 center_radius, f32 *t_hit)
 {
-    for (usize projectile_idx = 0; projectile_idx < state->entity_count; ++projectile_idx) {
-        if (state->entities[projectile_idx].tag != Tag_Projectile ||
-            !HasFlag(state->entities[projectile_idx].components, Comp_Render)) {
-            continue;
-        }
+    Vector2 d = Vector2Subtract(end, start);
+    Vector2 m = Vector2Subtract(start, center);
+    f32 r = radius + center_radius;
+
+    f32 c = Vector2DotProduct(m, m) - r * r;
+    if (c <= 0.0f) {
+        *t_hit = 0.0f;
+        return true;
+    }
 
-        renderable projectile_r = state->renderables[projectile_idx];
-        position projectile_pos = state->positions[projectile_idx];
+    f32 a = Vector2DotProduct(d, d);
+    f32 b = Vector2DotProduct(m, d);
+    if (a <= 0.0f || b >= 0.0f) {
+        return false;
+    }
 
-        for (usize enemy_idx = 0; enemy_idx < state->entity_count; ++enemy_idx) {
-            if (state->entities[enemy_idx].tag != Tag_Enemy) {
-                continue;
-            }
+    f32 discriminant = b * b - a * c;
+    if (discriminant < 0.0f) {
+        return false;
+    }
 
-            renderable enemy_r = state->renderables[enemy_idx];
-            position enemy_pos = state->positions[enemy_idx];
+    f32 t = (-b - sqrtf(discriminant)) / a;
+    if (t > 1.0f) {
+        return false;
+    }
 
-            if (CheckCollisionCircles(
-                projectile_pos.value, projectile_r.radius, enemy_pos.value, enemy_r.radius)) {
-                AddFlag(state->entities[enemy_idx].components, Comp_Collision);
-                state->entities[projectile_idx].tag = Tag_Dead;
+    *t_hit = t;
+    return true;
+}
 
-                OnEnemyHit(state, enemy_idx);
+internal void
+ProjectileMovementSystem(game_state *state, game_input *input)
+{
+    for (usize i = 0; i < state->projectile_count; ++i) {
+        projectile *p = &state->projectiles[i];
+        p->pos = Vector2Add(p->pos, Vector2Scale(p->velocity, input->dt));
+    }
+}
 
-                break;
+internal void
+ProjectileCollisionSystem(game_state *state, game_input *input)
+{
+    temporary_memory temp = BeginTemporaryMemory(&state->world_arena);
+    circle_batch enemies = GatherEnemyCircles(state, &state->world_arena, input->dt);
+
+    f32 projectile_radius = Prototypes[Proto_Projectile].radius;
+
+    usize projectile_idx = 0;
+    while (projectile_idx < state->projectile_count) {
+        projectile p = state->projectiles[projectile_idx];
+
+        Vector2 step = Vector2Scale(p.velocity, input->dt);
+        Vector2 sweep_center = Vector2Subtract(p.pos, Vector2Scale(step, 0.5f));
+        f32 sweep_radius = projectile_radius + Vector2Length(step) * 0.5f;
+
+        usize hit_idx = state->entity_count;
+        f32 hit_t = 1.0f;
+
+        for (usize base = 0; base < enemies.count; base += CIRCLE_BATCH_WIDTH) {
+            usize count = Min(enemies.count - base, CIRCLE_BATCH_WIDTH);
+            u32 candidates = CheckCollisionCirclesBatch(sweep_center,
+                                                        sweep_radius,
+                                                        enemies.x + base,
+                                                        enemies.y + base,
+                                                        enemies.radius + base,
+                                                        count);
+
+            while (candidates) {
+                u32 lane = (u32)__builtin_ctz(candidates);
+                candidates &= candidates - 1;
+
+                usize enemy_idx = enemies.index[base + lane];
+                f32 enemy_radius = GetPrototype(state, enemy_idx)->radius;
+                position enemy_pos = state->positions[enemy_idx];
+                velocity enemy_vel = state->velocities[enemy_idx];
+
+                Vector2 relative_step =
+                    Vector2Scale(Vector2Subtract(p.velocity, enemy_vel.value), input->dt);
+                Vector2 start = Vector2Subtract(p.pos, relative_step);
+
+                f32 t;
+                if (CheckCollisionSweptCircles(
+                        start, p.pos, projectile_radius, enemy_pos.value, enemy_radius, &t) &&
+                    t <= hit_t) {
+                    hit_idx = enemy_idx;
+                    hit_t = t;
+                }
             }
         }
+
+        if (hit_idx < state->entity_count) {
+            AddFlag(state->entities[hit_idx].components, Comp_Collision);
+            OnEnemyHit(state, hit_idx);
+
+            FreeProjectile(state, projectile_idx);
+            continue;
+        }
+
+        projectile_idx += 1;
     }
+
+    EndTemporaryMemory(temp);
 }
 
 internal void
-ProjectileBoundarySystem(game_state *state)
+ProjectileBoundarySystem(game_state *state, game_input *input)
 {
     Vector2 top_lefft = GetScreenToWorld2D(Vector2Zero(), state->camera);
-    Vector2 bottom_right = GetScreenToWorld2D(
-        (Vector2){ (f32)GetScreenWidth(), (f32)GetScreenHeight() }, state->camera);
+    Vector2 bottom_right = GetScreenToWorld2D(input->screen_size, state->camera);
 
     f32 buffer = 100.0f;
     f32 min_x = top_lefft.x - buffer;
@@ -303,21 +695,21 @@ ProjectileBoundarySystem(game_state *state)
     f32 min_y = top_lefft.y - buffer;
     f32 max_y = bottom_right.y + buffer;
 
-    for (usize i = 0; i < state->entity_count; ++i) {
-        if (state->entities[i].tag != Tag_Projectile) {
-            continue;
-        }
-
-        Vector2 p = state->positions[i].value;
+    usize i = 0;
+    while (i < state->projectile_count) {
+        Vector2 p = state->projectiles[i].pos;
 
         if (p.x < min_x || p.x > max_x || p.y < min_y || p.y > max_y) {
-            state->entities[i].tag = Tag_Dead;
+            FreeProjectile(state, i);
+            continue;
         }
+
+        i += 1;
     }
 }
 
 internal void
-CameraSystem(game_state *state)
+CameraSystem(game_state *state, game_input *input)
 {
     if (!HasFlags(state->entities[state->player_index].components, Comp_Position))
         return;
@@ -328,25 +720,157 @@ CameraSystem(game_state *state)
     state->camera.target = Vector2Lerp(state->camera.target, player_pos, lerp_factor);
     state->camera.zoom = 1.0f;
 
-    state->camera.offset = (Vector2){ (f32)GetScreenWidth() / 2.0f, (f32)GetScreenHeight() / 2.0f };
+    state->camera.offset = Vector2Scale(input->screen_size, 0.5f);
 }
 
 internal void
 EffectSystem(game_state *state, game_input *input)
 {
+    usize i = 0;
+    while (i < state->flash_count) {
+        flash_effect *flash = &state->flashes[i];
+        flash->timer -= input->dt;
+
+        if (flash->timer > 0) {
+            i += 1;
+            continue;
+        }
+
+        ClearFlag(state->entities[flash->entity].components, Comp_Flash);
+        *flash = state->flashes[--state->flash_count];
+    }
+}
+
+internal inline i32
+GetChunkCoord(f32 value)
+{
+    return (i32)floorf(value / WORLD_CHUNK_SIZE);
+}
+
+internal world_chunk *
+GetWorldChunk(game_state *state, i32 chunk_x, i32 chunk_y, b32 create)
+{
+    u32 hash_value = (u32)(chunk_x * 19 + chunk_y * 7);
+    usize hash_slot = hash_value & (ArrayCount(state->chunk_hash) - 1);
+
+    world_chunk *chunk = state->chunk_hash[hash_slot];
+    while (chunk) {
+        if (chunk->x == chunk_x && chunk->y == chunk_y) {
+            return chunk;
+        }
+        chunk = chunk->next_in_hash;
+    }
+
+    if (create) {
+        chunk = PushStruct(&state->world_arena, world_chunk);
+        chunk->x = chunk_x;
+        chunk->y = chunk_y;
+        chunk->first_block = 0;
+        chunk->next_in_hash = state->chunk_hash[hash_slot];
+        state->chunk_hash[hash_slot] = chunk;
+    }
+
+    return chunk;
+}
+
+internal void
+FreezeEntity(game_state *state, usize idx, world_chunk *chunk)
+{
+    cold_entity_block *block = chunk->first_block;
+    if (!block || block->count == ArrayCount(block->entities)) {
+        cold_entity_block *new_block = state->first_free_cold_block;
+        if (new_block) {
+            state->first_free_cold_block = new_block->next;
+        } else {
+            new_block = PushStruct(&state->world_arena, cold_entity_block);
+        }
+
+        new_block->count = 0;
+        new_block->next = block;
+        chunk->first_block = new_block;
+        block = new_block;
+    }
+
+    block->entities[block->count++] = (cold_entity){
+        .pos = state->positions[idx].value,
+        .health = state->healths[idx].value,
+        .prototype = state->entities[idx].prototype,
+    };
+    state->cold_entity_count += 1;
+
+    state->entities[idx].tag = Tag_Dead;
+}
+
+internal void
+ThawChunk(game_state *state, world_chunk *chunk)
+{
+    while (chunk->first_block) {
+        cold_entity_block *block = chunk->first_block;
+
+        usize count = block->count;
+        if (ArrayCount(state->entities) - state->entity_count < count) {
+            break;
+        }
+
+        usize first = ReserveEntities(state, &count);
+        for (usize i = 0; i < count; ++i) {
+            cold_entity *cold = &block->entities[i];
+            usize idx = first + i;
+
+            state->entities[idx] = (entity){
+                .components = Comp_Position | Comp_Velocity | Comp_Render | Comp_Health,
+                .tag = Tag_Enemy,
+                .prototype = cold->prototype,
+            };
+            state->positions[idx].value = cold->pos;
+            state->velocities[idx].value = Vector2Zero();
+            state->healths[idx].value = cold->health;
+        }
+        state->cold_entity_count -= count;
+
+        chunk->first_block = block->next;
+        block->next = state->first_free_cold_block;
+        state->first_free_cold_block = block;
+    }
+}
+
+internal void
+WorldStreamingSystem(game_state *state)
+{
+    i32 camera_x = GetChunkCoord(state->camera.target.x);
+    i32 camera_y = GetChunkCoord(state->camera.target.y);
+
     for (usize i = 0; i < state->entity_count; ++i) {
-        if (!HasFlag(state->entities[i].components, Comp_Render)) {
+        if (state->entities[i].tag != Tag_Enemy) {
             continue;
         }
 
-        if (state->renderables[i].flash_timer > 0) {
-            state->renderables[i].flash_timer -= input->dt;
+        Vector2 p = state->positions[i].value;
+        i32 chunk_x = GetChunkCoord(p.x);
+        i32 chunk_y = GetChunkCoord(p.y);
+
+        if (abs(chunk_x - camera_x) > FREEZE_CHUNK_RADIUS ||
+            abs(chunk_y - camera_y) > FREEZE_CHUNK_RADIUS) {
+            FreezeEntity(state, i, GetWorldChunk(state, chunk_x, chunk_y, true));
+        }
+    }
+
+    if (!state->cold_entity_count) {
+        return;
+    }
+
+    for (i32 y = camera_y - ACTIVE_CHUNK_RADIUS; y <= camera_y + ACTIVE_CHUNK_RADIUS; ++y) {
+        for (i32 x = camera_x - ACTIVE_CHUNK_RADIUS; x <= camera_x + ACTIVE_CHUNK_RADIUS; ++x) {
+            world_chunk *chunk = GetWorldChunk(state, x, y, false);
+            if (chunk) {
+                ThawChunk(state, chunk);
+            }
         }
     }
 }
 
 internal void
-RenderSystem(game_state *state)
+RenderSystem(game_state *state, render_snapshot *snapshot)
 {
     for (usize i = 0; i < state->entity_count; ++i) {
         if (state->entities[i].tag == Tag_Dead) {
@@ -358,10 +882,21 @@ RenderSystem(game_state *state)
         }
 
         position p = state->positions[i];
-        renderable r = state->renderables[i];
+        const entity_prototype *proto = GetPrototype(state, i);
+
+        b32 is_flashing = HasFlag(state->entities[i].components, Comp_Flash);
+        Color draw_color = is_flashing ? proto->flash_color : proto->color;
+        PushRenderCircle(snapshot, p.value, proto->radius, draw_color);
+    }
+}
 
-        Color draw_color = r.flash_timer > 0 ? r.flash_color : r.color;
-        DrawCircleV(p.value, r.radius, draw_color);
+internal void
+RenderProjectiles(game_state *state, render_snapshot *snapshot)
+{
+    f32 radius = Prototypes[Proto_Projectile].radius;
+    for (usize i = 0; i < state->projectile_count; ++i) {
+        projectile p = state->projectiles[i];
+        PushRenderCircle(snapshot, p.pos, radius, p.color);
     }
 }
 
@@ -371,22 +906,30 @@ PlayerInputSystem(game_state *state, game_input *input)
     velocity *player_velocity = &state->velocities[state->player_index];
     player_velocity->value = Vector2Zero();
 
-    f32 speed = 200.0f;
-    if (input->action_up)
-        player_velocity->value.y = -speed;
-    if (input->action_down)
-        player_velocity->value.y = speed;
-    if (input->action_left)
-        player_velocity->value.x = -speed;
-    if (input->action_right)
-        player_velocity->value.x = speed;
+    f32 speed = Prototypes[Proto_Player].speed;
+    f32 up = GetHeldFraction(input, Action_Up, input->action_up);
+    f32 down = GetHeldFraction(input, Action_Down, input->action_down);
+    f32 left = GetHeldFraction(input, Action_Left, input->action_left);
+    f32 right = GetHeldFraction(input, Action_Right, input->action_right);
+
+    if (up > 0.0f)
+        player_velocity->value.y = -speed * up;
+    if (down > 0.0f)
+        player_velocity->value.y = speed * down;
+    if (left > 0.0f)
+        player_velocity->value.x = -speed * left;
+    if (right > 0.0f)
+        player_velocity->value.x = speed * right;
 }
 
 internal void
 HealthSystem(game_state *state)
 {
-    for (usize i = 0; i < state->entity_count; ++i) {
+    // Health only drops in the hit handlers, so only damaged entities can have died.
+    for (usize d = 0; d < state->damaged_count; ++d) {
+        usize i = state->damaged[d];
         entity *e = &state->entities[i];
+        ClearFlag(e->components, Comp_Damaged);
 
         if (!HasFlags(e->components, Comp_Health | Comp_Render | Comp_Position)) {
             continue;
@@ -397,69 +940,276 @@ HealthSystem(game_state *state)
         if (health->value <= 0.0f) {
             health->value = 0.0f;
 
-            EmitDisintegrate(state,
-                             state->positions[i].value,
-                             state->renderables[i].color,
-                             state->renderables[i].radius);
+            const entity_prototype *proto = GetPrototype(state, i);
+            EmitDisintegrate(state, state->positions[i].value, proto->color, proto->radius);
+
+            if (e->tag == Tag_Enemy) {
+                state->kill_count += 1;
+            }
             state->entities[i].tag = Tag_Dead;
         }
     }
+    state->damaged_count = 0;
 }
 
-extern GAME_UPDATE_AND_RENDER(GameUpdateAndRender)
+internal void
+DumpMemoryStats(game_state *state, platform_memory *memory)
 {
+    memory_arena *arena = &state->world_arena;
+
+    fprintf(stderr, "permanent_storage: %zu KB\n", memory->permanent_storage_size / KB(1));
+    fprintf(stderr, "game_state: %zu KB\n", sizeof(*state) / KB(1));
+
+#define DumpField(name) \
+    fprintf(stderr, "  %-20s %8zu KB\n", #name, sizeof(state->name) / KB(1));
+    DumpField(entities);
+#define X(type, name) DumpField(name)
+    COMPONENT_LIST
+#undef X
+    DumpField(damaged);
+    DumpField(flashes);
+    DumpField(projectiles);
+    DumpField(particles);
+    DumpField(chunk_hash);
+#undef DumpField
+
+    fprintf(stderr,
+            "world_arena: %zu blocks, %zu / %zu KB used, high water %zu KB\n",
+            arena->block_count,
+            arena->total_used / KB(1),
+            arena->total_reserved / KB(1),
+            arena->high_water_mark / KB(1));
+
+    usize block_idx = arena->block_count;
+    for (memory_block *block = arena->current_block; block; block = block->prev) {
+        usize used = block == arena->current_block ? arena->used : block->used;
+        fprintf(stderr,
+                "  block %zu: %zu / %zu KB\n",
+                --block_idx,
+                used / KB(1),
+                (block->size - sizeof(*block)) / KB(1));
+    }
+
+#if DEBUG
+    fprintf(stderr, "world_arena sites (cumulative):\n");
+    for (usize i = 0; i < arena->site_count; ++i) {
+        arena_site *site = &arena->sites[i];
+        fprintf(stderr,
+                "  %-40s %10zu KB %10zu calls\n",
+                site->site,
+                site->bytes / KB(1),
+                site->count);
+    }
+#endif
+}
+
+internal void
+DebugSystem(game_state *state, platform_memory *memory, game_input *input)
+{
+    if (input->debug_toggle_overlay && !state->overlay_key_was_down) {
+        state->show_memory_overlay = !state->show_memory_overlay;
+    }
+    state->overlay_key_was_down = input->debug_toggle_overlay;
+
+    if (input->debug_dump_memory && !state->dump_key_was_down) {
+        DumpMemoryStats(state, memory);
+    }
+    state->dump_key_was_down = input->debug_dump_memory;
+}
+
+internal void
+RenderMemoryOverlay(game_state *state, platform_memory *memory, render_snapshot *snapshot)
+{
+    memory_overlay *overlay = &snapshot->memory;
+    overlay->visible = state->show_memory_overlay;
+    overlay->permanent_storage_size = memory->permanent_storage_size;
+    overlay->game_state_size = sizeof(*state);
+    overlay->arena_block_count = state->world_arena.block_count;
+    overlay->arena_used = state->world_arena.total_used;
+    overlay->arena_reserved = state->world_arena.total_reserved;
+    overlay->arena_high_water_mark = state->world_arena.high_water_mark;
+}
+
+internal u64
+HashBytes(u64 hash, const void *data, usize size)
+{
+    const u8 *bytes = (const u8 *)data;
+    for (usize i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ULL;
+    }
+
+    return hash;
+}
+
+// Live ranges only, so stale slots past the counts can't cause false divergences.
+internal u64
+HashGameState(game_state *state)
+{
+    u64 hash = 0xCBF29CE484222325ULL;
+
+    hash = HashBytes(hash, &state->mode, sizeof(state->mode));
+    hash = HashBytes(hash, &state->camera, sizeof(state->camera));
+    hash = HashBytes(hash, &state->time, sizeof(state->time));
+    hash = HashBytes(hash, &state->random_state, sizeof(state->random_state));
+    hash = HashBytes(hash, &state->player_index, sizeof(state->player_index));
+    hash = HashBytes(hash, &state->enemy_spawn_timer, sizeof(state->enemy_spawn_timer));
+    hash = HashBytes(hash, &state->projectile_spawn_timer, sizeof(state->projectile_spawn_timer));
+    hash = HashBytes(hash, &state->cold_entity_count, sizeof(state->cold_entity_count));
+
+    hash = HashBytes(hash, &state->entity_count, sizeof(state->entity_count));
+    hash = HashBytes(hash, state->entities, state->entity_count * sizeof(*state->entities));
+#define X(type, name) \
+    hash = HashBytes(hash, state->name, state->entity_count * sizeof(*state->name));
+    COMPONENT_LIST
+#undef X
+
+    hash = HashBytes(hash, &state->projectile_count, sizeof(state->projectile_count));
+    hash = HashBytes(
+        hash, state->projectiles, state->projectile_count * sizeof(*state->projectiles));
+
+    hash = HashBytes(hash, &state->flash_count, sizeof(state->flash_count));
+    hash = HashBytes(hash, state->flashes, state->flash_count * sizeof(*state->flashes));
+
+    hash = HashBytes(hash, &state->effects, sizeof(state->effects));
+    hash = HashBytes(hash, &state->next_particle, sizeof(state->next_particle));
+    hash = HashBytes(hash, state->particles, sizeof(state->particles));
+
+    return hash;
+}
+
+internal void
+RecordStateHash(game_state *state, state_hashes *hashes, const char *name)
+{
+    if (!hashes || hashes->count >= ArrayCount(hashes->values)) {
+        return;
+    }
+
+    hashes->names[hashes->count] = name;
+    hashes->values[hashes->count] = HashGameState(state);
+    hashes->count += 1;
+}
+
+#define RunSystem(system, ...) \
+    Stmt(system(__VA_ARGS__); RecordStateHash(state, memory->state_hashes, #system);)
+
+extern GAME_UPDATE(GameUpdate)
+{
+    // Written only on the first call and after a reload; batch workers share it.
+    if (memcmp(&Platform, &memory->platform, sizeof(Platform)) != 0) {
+        Platform = memory->platform;
+    }
+
     game_state *state = (game_state *)memory->permanent_storage;
     state->time += input->dt;
 
+    if (memory->state_hashes) {
+        memory->state_hashes->count = 0;
+    }
+
+    render_snapshot *snapshot = 0;
+    if (render) {
+        Assert(sizeof(render_snapshot) <= render->size);
+        snapshot = (render_snapshot *)render->base;
+        snapshot->circle_count = 0;
+    }
+
     if (!state->is_initialized) {
         InitializeArena(&state->world_arena,
                         memory->permanent_storage_size - sizeof(game_state),
                         (u8 *)memory->permanent_storage + sizeof(game_state));
 
-        SpawnPlayer(state);
+        if (!state->random_state) {
+            state->random_state = memory->random_seed ? memory->random_seed : 1;
+            state->effects_random_state = ~state->random_state ? ~state->random_state : 1;
+        }
+
+        state->effects.quality = 1.0f;
+
+        SpawnPlayer(state, input);
         state->mode = GameMode_Playing;
 
         state->is_initialized = true;
     }
 
     if (state->mode == GameMode_Gameover) {
+        u64 random_state = state->random_state;
+        u64 effects_random_state = state->effects_random_state;
+
         ZeroSize(state->world_arena.used, state->world_arena.base);
         ZeroSize(sizeof(*state), state);
 
+        state->random_state = random_state;
+        state->effects_random_state = effects_random_state;
+        RecordStateHash(state, memory->state_hashes, "GameoverReset");
+
         return;
     }
 
     if (state->mode == GameMode_Playing) {
-        PlayerInputSystem(state, input);
-        EnemyAISystem(state);
-        SpawnSystem(state, input);
+        RunSystem(EffectsGovernorSystem, state, input);
+        RunSystem(PlayerInputSystem, state, input);
+        RunSystem(EnemyAISystem, state);
+        RunSystem(SpawnSystem, state, input);
 
-        MovementSystem(state, input);
+        RunSystem(MovementSystem, state, input);
+        RunSystem(ProjectileMovementSystem, state, input);
 
-        PlayerEnemyCollisionSystem(state);
-        ProjectileCollisionSystem(state);
-        ProjectileBoundarySystem(state);
+        RunSystem(PlayerEnemyCollisionSystem, state);
+        RunSystem(ProjectileCollisionSystem, state, input);
+        RunSystem(ProjectileBoundarySystem, state, input);
 
-        HealthSystem(state);
-        EffectSystem(state, input);
+        RunSystem(HealthSystem, state);
+        RunSystem(EffectSystem, state, input);
+        RunSystem(WorldStreamingSystem, state);
 
         if (state->entities[state->player_index].tag == Tag_Dead) {
             state->mode = GameMode_Gameover;
         }
     }
 
-    UpdateParticles(state, input);
-    CameraSystem(state);
+    RunSystem(UpdateParticles, state, input);
+    RunSystem(CameraSystem, state, input);
+    DebugSystem(state, memory, input);
+
+    if (snapshot) {
+        snapshot->camera = state->camera;
+        RenderSystem(state, snapshot);
+        RenderProjectiles(state, snapshot);
+        RenderParticles(state, snapshot);
+        RenderMemoryOverlay(state, memory, snapshot);
+    }
+
+    RunSystem(DespawnSystem, state);
+}
+
+extern GAME_RENDER(GameRender)
+{
+    render_snapshot *snapshot = (render_snapshot *)render->base;
 
-    BeginDrawing();
     ClearBackground(BLACK);
 
-    BeginMode2D(state->camera);
-    RenderSystem(state);
-    RenderParticles(state);
+    BeginMode2D(snapshot->camera);
+    for (usize i = 0; i < snapshot->circle_count; ++i) {
+        render_circle c = snapshot->circles[i];
+        DrawCircleV(c.pos, c.radius, c.color);
+    }
     EndMode2D();
     DrawFPS(10, 10);
-    EndDrawing();
 
-    DespawnSystem(state);
+    memory_overlay *overlay = &snapshot->memory;
+    if (overlay->visible) {
+        i32 y = 40;
+        DrawText(TextFormat("permanent_storage: %zu MB  game_state: %zu KB",
+                            overlay->permanent_storage_size / MB(1),
+                            overlay->game_state_size / KB(1)),
+                 10, y, 20, GREEN);
+        y += 22;
+        DrawText(TextFormat("world_arena: %zu / %zu KB in %zu blocks  high water: %zu KB",
+                            overlay->arena_used / KB(1),
+                            overlay->arena_reserved / KB(1),
+                            overlay->arena_block_count,
+                            overlay->arena_high_water_mark / KB(1)),
+                 10, y, 20, GREEN);
+    }
 }
@@ -1,6 +1,8 @@
 #ifndef GAME_H
 #define GAME_H
 
+#include <string.h>
+
 #include "raylib.h"
 #include "base_types.h"
 #include "platform.h"
@@ -8,8 +10,19 @@
 typedef struct memory_block {
     struct memory_block *prev;
     usize size;
+    usize used;
 } memory_block;
 
+#define MAX_ARENA_SITES 64
+#define MAX_ARENA_SITE_LENGTH 64
+
+// Copied, not pointed to: the literal lives in game.so, which a hot reload unmaps.
+typedef struct {
+    char site[MAX_ARENA_SITE_LENGTH];
+    usize bytes;
+    usize count;
+} arena_site;
+
 typedef struct {
     memory_block *current_block;
     u8 *base;
@@ -18,11 +31,22 @@ typedef struct {
     usize minimum_block_size;
 
     usize temp_count;
+
+    usize block_count;
+    usize total_reserved;
+    usize total_used;
+    usize high_water_mark;
+
+#if DEBUG
+    arena_site sites[MAX_ARENA_SITES];
+    usize site_count;
+#endif
 } memory_arena;
 
 typedef struct {
     memory_arena *arena;
     usize used;
+    usize total_used;
 } temporary_memory;
 
 typedef struct {
@@ -34,7 +58,9 @@ typedef struct {
 } velocity;
 
 typedef struct {
-    Vector2 value;
+    Vector2 pos;
+    Vector2 velocity;
+    Color color;
 } projectile;
 
 typedef struct {
@@ -42,11 +68,9 @@ typedef struct {
 } health;
 
 typedef struct {
-    Color color;
-    f32 radius;
-    f32 flash_timer;
-    Color flash_color;
-} renderable;
+    u32 entity;
+    f32 timer;
+} flash_effect;
 
 typedef struct {
     Vector2 pos;
@@ -65,35 +89,116 @@ typedef Enum(u8, component_mask) {
     Comp_Health     = (1 << 2),
     Comp_Render     = (1 << 3),
     Comp_Collision  = (1 << 4),
+    Comp_Flash      = (1 << 5),
+    Comp_Damaged    = (1 << 6),
 };
 
 typedef Enum(u8, tag_type) {
     Tag_Player,
     Tag_Enemy,
-    Tag_Projectile,
     Tag_Dead,
 };
+
+typedef Enum(u8, prototype_id) {
+    Proto_Player,
+    Proto_Enemy,
+    Proto_Projectile,
+
+    Proto_Count,
+};
 // clang-format on
 
+typedef struct {
+    Color color;
+    Color flash_color;
+    f32 radius;
+    f32 max_health;
+    f32 damage;
+    f32 speed;
+    f32 max_speed;
+} entity_prototype;
+
 typedef struct {
     component_mask components;
     tag_type tag;
+    prototype_id prototype;
 } entity;
 
+#define WORLD_CHUNK_SIZE 1024.0f
+#define WORLD_CHUNK_HASH_COUNT 4096
+#define ACTIVE_CHUNK_RADIUS 2
+#define FREEZE_CHUNK_RADIUS (ACTIVE_CHUNK_RADIUS + 1)
+#define COLD_BLOCK_CAPACITY 64
+
+typedef struct {
+    Vector2 pos;
+    f32 health;
+    prototype_id prototype;
+} cold_entity;
+
+typedef struct cold_entity_block {
+    struct cold_entity_block *next;
+    usize count;
+    cold_entity entities[COLD_BLOCK_CAPACITY];
+} cold_entity_block;
+
+typedef struct world_chunk {
+    struct world_chunk *next_in_hash;
+    i32 x;
+    i32 y;
+
+    cold_entity_block *first_block;
+} world_chunk;
+
+#define FRAME_BUDGET (1.0f / 60.0f)
+#define MIN_EFFECTS_QUALITY 0.1f
+
+typedef struct {
+    f32 average_cost;
+    f32 quality;
+} effects_governor;
+
 typedef Enum(u8, game_mode){
     GameMode_Playing,
     GameMode_Gameover,
 };
 
 #define MAX_ENTITIES Thousand(10)
+#define MAX_PROJECTILES 512
+#define MAX_PARTICLES Thousand(2)
+#define MAX_FLASH_EFFECTS 1024
+#define MAX_RENDER_CIRCLES (MAX_ENTITIES + MAX_PROJECTILES + MAX_PARTICLES)
 
-// TODO(fcasibu): stats (e.g. damage, speed, etc)
-#define COMPONENT_LIST         \
-    X(position, positions)     \
-    X(velocity, velocities)    \
-    X(renderable, renderables) \
-    X(health, healths)         \
-    X(projectile, projectiles)
+typedef struct {
+    Vector2 pos;
+    f32 radius;
+    Color color;
+} render_circle;
+
+typedef struct {
+    b32 visible;
+
+    usize permanent_storage_size;
+    usize game_state_size;
+
+    usize arena_block_count;
+    usize arena_used;
+    usize arena_reserved;
+    usize arena_high_water_mark;
+} memory_overlay;
+
+typedef struct {
+    Camera2D camera;
+    memory_overlay memory;
+
+    usize circle_count;
+    render_circle circles[MAX_RENDER_CIRCLES];
+} render_snapshot;
+
+#define COMPONENT_LIST      \
+    X(position, positions)  \
+    X(velocity, velocities) \
+    X(health, healths)
 
 typedef struct {
     b32 is_initialized;
@@ -110,12 +215,35 @@ typedef struct {
     COMPONENT_LIST
 #undef X
 
+    u32 damaged[MAX_ENTITIES];
+    usize damaged_count;
+
+    flash_effect flashes[MAX_FLASH_EFFECTS];
+    usize flash_count;
+
     usize player_index;
+    usize kill_count;
     f32 enemy_spawn_timer;
     f32 projectile_spawn_timer;
 
-    particle particles[Thousand(2)];
+    projectile projectiles[MAX_PROJECTILES];
+    usize projectile_count;
+
+    particle particles[MAX_PARTICLES];
     usize next_particle;
+    effects_governor effects;
+
+    world_chunk *chunk_hash[WORLD_CHUNK_HASH_COUNT];
+    cold_entity_block *first_free_cold_block;
+    usize cold_entity_count;
+
+    u64 random_state;
+    // Particle count follows the host's frame cost, so effects draw from their own series.
+    u64 effects_random_state;
+
+    b32 show_memory_overlay;
+    b32 overlay_key_was_down;
+    b32 dump_key_was_down;
 } game_state;
 
 internal inline void
@@ -130,6 +258,11 @@ InitializeArena(memory_arena *arena, usize size, void *base)
     arena->used = 0;
     arena->capacity = size - sizeof(*first_block);
     arena->minimum_block_size = 0;
+
+    arena->block_count = 1;
+    arena->total_reserved = size;
+    arena->total_used = 0;
+    arena->high_water_mark = 0;
 }
 
 internal inline usize
@@ -158,13 +291,43 @@ ZeroSize(usize size, void *ptr)
     }
 }
 
+#define Stringify_(x) #x
+#define Stringify(x) Stringify_(x)
+#define ArenaSite __FILE__ ":" Stringify(__LINE__)
+
 #define PushArray(a, count, type) \
-    (type *)PushSize_((a), (count) * sizeof(type), alignof(max_align_t))
-#define PushStruct(a, type) (type *)PushSize_((a), sizeof(type), alignof(max_align_t))
-#define PushSize(a, size) PushSize_((a), (size), alignof(max_align_t))
+    (type *)PushSize_((a), (count) * sizeof(type), alignof(max_align_t), ArenaSite)
+#define PushStruct(a, type) \
+    (type *)PushSize_((a), sizeof(type), alignof(max_align_t), ArenaSite)
+#define PushSize(a, size) PushSize_((a), (size), alignof(max_align_t), ArenaSite)
+
+internal inline void
+RecordArenaSite(memory_arena *arena, const char *site, usize size)
+{
+#if DEBUG
+    for (usize i = 0; i < arena->site_count; ++i) {
+        if (strncmp(arena->sites[i].site, site, MAX_ARENA_SITE_LENGTH - 1) == 0) {
+            arena->sites[i].bytes += size;
+            arena->sites[i].count += 1;
+            return;
+        }
+    }
+
+    if (arena->site_count < ArrayCount(arena->sites)) {
+        arena_site *entry = &arena->sites[arena->site_count++];
+        snprintf(entry->site, sizeof(entry->site), "%s", site);
+        entry->bytes = size;
+        entry->count = 1;
+    }
+#else
+    Unused(arena);
+    Unused(site);
+    Unused(size);
+#endif
+}
 
 internal inline void *
-PushSize_(memory_arena *arena, usize size_init, usize alignment)
+PushSize_(memory_arena *arena, usize size_init, usize alignment, const char *site)
 {
     usize size = GetEffectiveSize(arena, size_init, alignment);
 
@@ -176,12 +339,22 @@ PushSize_(memory_arena *arena, usize size_init, usize alignment)
         Assert(Platform.AllocateMemory);
         usize header_size = sizeof(memory_block);
         usize block_size = Max(size + header_size, arena->minimum_block_size);
+        usize granularity = Platform.allocation_granularity;
+        if (granularity) {
+            block_size = (block_size + granularity - 1) / granularity * granularity;
+        }
 
         memory_block *new_block = (memory_block *)Platform.AllocateMemory(block_size);
         Assert(new_block);
 
+        arena->current_block->used = arena->used;
+
         new_block->prev = arena->current_block;
         new_block->size = block_size;
+        new_block->used = 0;
+
+        arena->block_count += 1;
+        arena->total_reserved += block_size;
 
         arena->current_block = new_block;
         arena->base = (u8 *)new_block + header_size;
@@ -196,6 +369,10 @@ PushSize_(memory_arena *arena, usize size_init, usize alignment)
     void *result = arena->base + arena->used + alignment_offset;
     arena->used += size;
 
+    arena->total_used += size;
+    arena->high_water_mark = Max(arena->high_water_mark, arena->total_used);
+    RecordArenaSite(arena, site, size);
+
     Assert(size >= size_init);
 
     return result;
@@ -227,6 +404,7 @@ BeginTemporaryMemory(memory_arena *arena)
 
     result.arena = arena;
     result.used = arena->used;
+    result.total_used = arena->total_used;
     arena->temp_count += 1;
 
     return result;
@@ -238,6 +416,7 @@ EndTemporaryMemory(temporary_memory temp_mem)
     memory_arena *arena = temp_mem.arena;
     Assert(arena->used >= temp_mem.used);
     arena->used = temp_mem.used;
+    arena->total_used = temp_mem.total_used;
     Assert(arena->temp_count > 0);
     arena->temp_count -= 1;
 }
@@ -5,18 +5,28 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
 
 #include "raylib.h"
 #include "base_types.h"
 #include "platform.h"
+#include "posix_platform.h"
 
-GAME_UPDATE_AND_RENDER(GameUpdateAndRender);
+GAME_UPDATE(GameUpdate);
+GAME_RENDER(GameRender);
+
+#define SIMULATION_HZ 60
+#define RENDER_HZ 60
+#define INPUT_SAMPLE_HZ 1000
 
 typedef struct {
     void *game_code_handle;
     long last_write_time;
 
-    game_update_and_render *UpdateAndRender;
+    game_update *Update;
+    game_render *Render;
 } game_code;
 
 [[maybe_unused]] internal long
@@ -41,8 +51,8 @@ LoadGameCode(const char *source_lib_path)
         return result;
     }
 
-    result.UpdateAndRender =
-        (game_update_and_render *)dlsym(result.game_code_handle, "GameUpdateAndRender");
+    result.Update = (game_update *)dlsym(result.game_code_handle, "GameUpdate");
+    result.Render = (game_render *)dlsym(result.game_code_handle, "GameRender");
 
     return result;
 }
@@ -55,86 +65,391 @@ UnloadGameCode(game_code *code)
         code->game_code_handle = NULL;
     }
 
-    code->UpdateAndRender = NULL;
+    code->Update = NULL;
+    code->Render = NULL;
 }
 
 [[maybe_unused]] internal void
 ReloadGameCode(game_code *game_code, const char *game_lib_path)
 {
-    if (game_code->UpdateAndRender) {
+    if (game_code->Update) {
         UnloadGameCode(game_code);
         *game_code = LoadGameCode(game_lib_path);
     }
 }
 
-internal void *
-AllocateMemory(usize size)
+// Lock-free SPSC triple buffer. Each side owns a slot and the third is swapped through
+// `shared`; the fresh bit marks a slot the consumer hasn't picked up yet.
+#define TRIPLE_BUFFER_FRESH 0x4u
+#define TRIPLE_BUFFER_INDEX 0x3u
+
+typedef struct {
+    _Atomic u32 shared;
+    u32 write_index;
+    u32 read_index;
+} triple_buffer;
+
+internal void
+InitTripleBuffer(triple_buffer *buffer)
 {
-    void *result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    buffer->write_index = 0;
+    atomic_store(&buffer->shared, 1u);
+    buffer->read_index = 2;
+}
 
-    if (result == MAP_FAILED)
-        return NULL;
+internal void
+TripleBufferPublish(triple_buffer *buffer)
+{
+    u32 previous = atomic_exchange(&buffer->shared, buffer->write_index | TRIPLE_BUFFER_FRESH);
+    buffer->write_index = previous & TRIPLE_BUFFER_INDEX;
+}
 
-    return result;
+internal b32
+TripleBufferAcquire(triple_buffer *buffer)
+{
+    if (!(atomic_load(&buffer->shared) & TRIPLE_BUFFER_FRESH)) {
+        return false;
+    }
+
+    u32 previous = atomic_exchange(&buffer->shared, buffer->read_index);
+    buffer->read_index = previous & TRIPLE_BUFFER_INDEX;
+    return true;
+}
+
+#define INPUT_RING_SIZE 1024
+
+typedef struct {
+    f64 timestamp;
+    input_action action;
+    b32 is_down;
+} timed_input_event;
+
+typedef struct {
+    timed_input_event events[INPUT_RING_SIZE];
+    _Atomic u32 write_index;
+    _Atomic u32 read_index;
+} input_ring;
+
+internal b32
+InputRingPush(input_ring *ring, timed_input_event event)
+{
+    u32 write_index = atomic_load_explicit(&ring->write_index, memory_order_relaxed);
+    u32 read_index = atomic_load_explicit(&ring->read_index, memory_order_acquire);
+    if (write_index - read_index == INPUT_RING_SIZE) {
+        return false;
+    }
+
+    ring->events[write_index & (INPUT_RING_SIZE - 1)] = event;
+    atomic_store_explicit(&ring->write_index, write_index + 1, memory_order_release);
+    return true;
+}
+
+internal b32
+InputRingPeek(input_ring *ring, timed_input_event *event)
+{
+    u32 read_index = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+    u32 write_index = atomic_load_explicit(&ring->write_index, memory_order_acquire);
+    if (read_index == write_index) {
+        return false;
+    }
+
+    *event = ring->events[read_index & (INPUT_RING_SIZE - 1)];
+    return true;
+}
+
+internal void
+InputRingPop(input_ring *ring)
+{
+    u32 read_index = atomic_load_explicit(&ring->read_index, memory_order_relaxed);
+    atomic_store_explicit(&ring->read_index, read_index + 1, memory_order_release);
+}
+
+internal void
+SampleInput(input_ring *ring, b32 *sampled)
+{
+    b32 current[Action_Count] = {
+        [Action_Up] = IsKeyDown(KEY_W),
+        [Action_Down] = IsKeyDown(KEY_S),
+        [Action_Left] = IsKeyDown(KEY_A),
+        [Action_Right] = IsKeyDown(KEY_D),
+        [Action_Shoot] = IsMouseButtonDown(MOUSE_LEFT_BUTTON),
+    };
+
+    f64 now = GetWallClock();
+    for (u32 action = 0; action < Action_Count; ++action) {
+        if (current[action] == sampled[action]) {
+            continue;
+        }
+
+        timed_input_event event = { now, (input_action)action, current[action] };
+        if (InputRingPush(ring, event)) {
+            sampled[action] = current[action];
+        }
+    }
 }
 
 internal void
-DeallocateMemory(void *mem, usize size)
+DrainInputEvents(
+    input_ring *ring, game_input *input, b32 *action_state, f64 tick_start, f64 tick_end)
+{
+    input->event_count = 0;
+
+    timed_input_event event;
+    while (input->event_count < ArrayCount(input->events) && InputRingPeek(ring, &event) &&
+           event.timestamp <= tick_end) {
+        InputRingPop(ring);
+
+        f32 time = Max(0.0f, Min((f32)(event.timestamp - tick_start), input->dt));
+        input->events[input->event_count++] = (input_event){ time, event.action, event.is_down };
+        action_state[event.action] = event.is_down;
+    }
+
+    input->action_up = action_state[Action_Up];
+    input->action_down = action_state[Action_Down];
+    input->action_left = action_state[Action_Left];
+    input->action_right = action_state[Action_Right];
+    input->action_shoot = action_state[Action_Shoot];
+}
+
+typedef struct {
+    platform_memory *memory;
+    game_code *game;
+    input_replay replay;
+
+    input_ring input_events;
+
+    triple_buffer input_exchange;
+    game_input inputs[3];
+
+    triple_buffer snapshot_exchange;
+    render_buffer snapshots[3];
+
+    _Atomic f32 render_cost;
+
+    _Atomic b32 running;
+    _Atomic b32 pause_requested;
+    _Atomic b32 paused;
+} simulation_context;
+
+internal void *
+SimulationThread(void *param)
 {
-    if (mem) {
-        munmap(mem, size);
+    simulation_context *context = (simulation_context *)param;
+
+    f64 target_seconds_per_tick = 1.0 / SIMULATION_HZ;
+    f64 last_tick = GetWallClock();
+    f64 next_tick = last_tick;
+
+    game_input input = { 0 };
+    b32 has_input = false;
+    b32 action_state[Action_Count] = { 0 };
+    f32 simulation_cost = 0.0f;
+
+    while (atomic_load(&context->running)) {
+        if (atomic_load(&context->pause_requested)) {
+            atomic_store(&context->paused, true);
+            while (atomic_load(&context->pause_requested)) {
+                SleepUntil(GetWallClock() + 0.001);
+            }
+            atomic_store(&context->paused, false);
+
+            last_tick = GetWallClock();
+            next_tick = last_tick;
+        }
+
+        input_replay *replay = &context->replay;
+
+        if (TripleBufferAcquire(&context->input_exchange)) {
+            input = context->inputs[context->input_exchange.read_index];
+            has_input = true;
+        }
+
+        f64 now = GetWallClock();
+        input.dt = (f32)(now - last_tick);
+        DrainInputEvents(&context->input_events, &input, action_state, last_tick, now);
+        input.frame_cost = Max(simulation_cost, atomic_load(&context->render_cost));
+        last_tick = now;
+
+        if (replay->mode == Replay_Playback) {
+            if (!PlayBackInput(replay, &input)) {
+                atomic_store(&context->running, false);
+                break;
+            }
+            has_input = true;
+        }
+
+        if (has_input && context->game->Update) {
+            render_buffer *render =
+                &context->snapshots[context->snapshot_exchange.write_index];
+            context->game->Update(context->memory, &input, render);
+            TripleBufferPublish(&context->snapshot_exchange);
+            simulation_cost = (f32)(GetWallClock() - now);
+
+            if (replay->mode == Replay_Recording) {
+                RecordFrame(replay, &input);
+            } else if (replay->mode == Replay_Playback) {
+                CheckPlaybackHashes(replay);
+            }
+        }
+
+        next_tick += target_seconds_per_tick;
+        if (next_tick < GetWallClock()) {
+            next_tick = GetWallClock();
+        }
+        SleepUntil(next_tick);
     }
+
+    EndReplay(&context->replay);
+
+    return NULL;
 }
 
 int
-main(void)
+main(int argc, char **argv)
 {
 #if DEBUG
     const char *game_lib_path = "./build/game.so";
     game_code game = LoadGameCode(game_lib_path);
+#else
+    game_code game = { .Update = GameUpdate, .Render = GameRender };
 #endif
 
     platform_memory memory = { 0 };
+    simulation_context context = { 0 };
+    context.memory = &memory;
+    context.game = &game;
+
+    memory.random_seed = (u64)(GetWallClock() * 1e9);
+    for (int i = 1; i < argc; ++i) {
+        b32 ok = true;
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+
+        if (strcmp(argv[i], "--record") == 0 && value) {
+            ok = BeginRecording(&context.replay, value, memory.random_seed);
+            i += 1;
+        } else if (strcmp(argv[i], "--playback") == 0 && value) {
+            ok = BeginPlayback(&context.replay, value, &memory.random_seed);
+            i += 1;
+        } else if (strcmp(argv[i], "--huge-pages") == 0 && value) {
+            if (strcmp(value, "transparent") == 0) {
+                MemoryConfig.strategy = Pages_Transparent;
+            } else if (strcmp(value, "explicit") == 0) {
+                MemoryConfig.strategy = Pages_Explicit;
+            } else if (strcmp(value, "off") != 0) {
+                fprintf(stderr, "Unknown --huge-pages mode: %s\n", value);
+                ok = false;
+            }
+            i += 1;
+        } else if (strcmp(argv[i], "--prefault") == 0) {
+            MemoryConfig.prefault = true;
+        } else {
+            fprintf(stderr, "Unknown argument: %s\n", argv[i]);
+            ok = false;
+        }
+
+        if (!ok) {
+            return 1;
+        }
+    }
+
+    if (context.replay.mode != Replay_None) {
+        memory.state_hashes = &context.replay.hashes;
+    }
+
     memory.permanent_storage_size = MB(256);
 
     usize total_size = memory.permanent_storage_size;
-    memory.permanent_storage = AllocateMemory(total_size);
+    page_strategy permanent_strategy;
+    memory.permanent_storage = AllocateMemoryWithStrategy(total_size, &permanent_strategy);
+    if (!memory.permanent_storage) {
+        fprintf(stderr,
+                "memory: could not allocate %zu MB of permanent storage\n",
+                total_size / MB(1));
+        return 1;
+    }
+
+    fprintf(stderr,
+            "memory: %zu MB permanent storage backed by %s%s\n",
+            total_size / MB(1),
+            PageStrategyNames[permanent_strategy],
+            MemoryConfig.prefault ? ", prefaulted" : "");
 
     memory.platform.AllocateMemory = AllocateMemory;
     memory.platform.DeallocateMemory = DeallocateMemory;
+    memory.platform.allocation_granularity = GetAllocationGranularity();
     Platform = memory.platform;
+    InitTripleBuffer(&context.input_exchange);
+    InitTripleBuffer(&context.snapshot_exchange);
+
+    for (usize i = 0; i < ArrayCount(context.snapshots); ++i) {
+        context.snapshots[i].size = GetMappedSize(MB(1));
+        context.snapshots[i].base = AllocateMemory(context.snapshots[i].size);
+    }
 
     InitWindow(1280, 720, "swarm");
 
-    SetTargetFPS(60);
-    while (!WindowShouldClose()) {
+    // GLFW only polls on the main thread, so it samples input and paces frames itself.
+    SetTargetFPS(0);
+
+    atomic_store(&context.running, true);
+    pthread_t simulation_thread;
+    pthread_create(&simulation_thread, NULL, SimulationThread, &context);
+
+    b32 sampled_actions[Action_Count] = { 0 };
+    f64 next_render = GetWallClock();
+
+    while (!WindowShouldClose() && atomic_load(&context.running)) {
+        PollInputEvents();
+        SampleInput(&context.input_events, sampled_actions);
+
+        f64 now = GetWallClock();
+        if (now < next_render) {
+            SleepUntil(Min(now + 1.0 / INPUT_SAMPLE_HZ, next_render));
+            continue;
+        }
+
+        next_render += 1.0 / RENDER_HZ;
+        if (next_render < now) {
+            next_render = now;
+        }
+
 #if DEBUG
         long new_write_time = GetLastWriteTime(game_lib_path);
 
         if (new_write_time > game.last_write_time) {
+            atomic_store(&context.pause_requested, true);
+            while (!atomic_load(&context.paused) && atomic_load(&context.running)) {
+                SleepUntil(GetWallClock() + 0.001);
+            }
+
             ReloadGameCode(&game, game_lib_path);
+
+            atomic_store(&context.pause_requested, false);
         }
 #endif
 
-        game_input input = {
-            .dt = GetFrameTime(),
-            .action_up = IsKeyDown(KEY_W),
-            .action_left = IsKeyDown(KEY_A),
-            .action_down = IsKeyDown(KEY_S),
-            .action_right = IsKeyDown(KEY_D),
-            .action_shoot = IsMouseButtonDown(MOUSE_LEFT_BUTTON),
+        context.inputs[context.input_exchange.write_index] = (game_input){
             .mouse_pos = GetMousePosition(),
+            .screen_size = { (f32)GetScreenWidth(), (f32)GetScreenHeight() },
+            .debug_toggle_overlay = IsKeyDown(KEY_F1),
+            .debug_dump_memory = IsKeyDown(KEY_F2),
         };
+        TripleBufferPublish(&context.input_exchange);
 
-#if DEBUG
-        if (game.UpdateAndRender) {
-            game.UpdateAndRender(&memory, &input);
+        TripleBufferAcquire(&context.snapshot_exchange);
+
+        BeginDrawing();
+        if (game.Render) {
+            f64 render_start = GetWallClock();
+            game.Render(&context.snapshots[context.snapshot_exchange.read_index]);
+            atomic_store(&context.render_cost, (f32)(GetWallClock() - render_start));
         }
-#else
-        GameUpdateAndRender(&memory, &input);
-#endif
+        EndDrawing();
     }
 
+    atomic_store(&context.running, false);
+    pthread_join(simulation_thread, NULL);
+
     CloseWindow();
 
     return 0;
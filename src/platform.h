@@ -9,12 +9,34 @@ platform_deallocate_memory(void *mem, usize size);
 typedef struct {
     platform_allocate_memory *AllocateMemory;
     platform_deallocate_memory *DeallocateMemory;
+    usize allocation_granularity;
 } platform_api;
 
 global platform_api Platform;
 
+// clang-format off
+typedef Enum(u8, input_action) {
+    Action_Up,
+    Action_Down,
+    Action_Left,
+    Action_Right,
+    Action_Shoot,
+
+    Action_Count,
+};
+// clang-format on
+
+typedef struct {
+    f32 time;
+    input_action action;
+    b32 is_down;
+} input_event;
+
+#define MAX_TICK_EVENTS 64
+
 typedef struct {
     f32 dt;
+    f32 frame_cost;
 
     b32 action_up;
     b32 action_down;
@@ -22,9 +44,29 @@ typedef struct {
     b32 action_right;
     b32 action_shoot;
 
+    u32 event_count;
+    input_event events[MAX_TICK_EVENTS];
+
     Vector2 mouse_pos;
+    Vector2 screen_size;
+
+    b32 debug_toggle_overlay;
+    b32 debug_dump_memory;
 } game_input;
 
+typedef struct {
+    usize size;
+    void *base;
+} render_buffer;
+
+#define MAX_HASHED_SYSTEMS 32
+
+typedef struct {
+    u32 count;
+    u64 values[MAX_HASHED_SYSTEMS];
+    const char *names[MAX_HASHED_SYSTEMS];
+} state_hashes;
+
 typedef struct {
     usize permanent_storage_size;
     void *permanent_storage;
@@ -32,11 +74,18 @@ typedef struct {
     usize temporary_storage_size;
     void *temporary_storage;
 
+    u64 random_seed;
+    state_hashes *state_hashes;
+
     platform_api platform;
 } platform_memory;
 
 
-#define GAME_UPDATE_AND_RENDER(name) void name(platform_memory *memory, game_input *input)
-typedef GAME_UPDATE_AND_RENDER(game_update_and_render);
+#define GAME_UPDATE(name) \
+    void name(platform_memory *memory, game_input *input, render_buffer *render)
+typedef GAME_UPDATE(game_update);
+
+#define GAME_RENDER(name) void name(render_buffer *render)
+typedef GAME_RENDER(game_render);
 
 #endif // PLATFORM_H
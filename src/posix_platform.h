@@ -0,0 +1,311 @@
+#ifndef POSIX_PLATFORM_H
+#define POSIX_PLATFORM_H
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "base_types.h"
+#include "platform.h"
+
+#define HUGE_PAGE_SIZE MB(2)
+
+typedef Enum(u8, page_strategy) {
+    Pages_Default,
+    Pages_Transparent,
+    Pages_Explicit,
+};
+
+[[maybe_unused]] global const char *PageStrategyNames[] = {
+    [Pages_Default] = "4 KB pages",
+    [Pages_Transparent] = "transparent huge pages",
+    [Pages_Explicit] = "explicit huge pages",
+};
+
+global struct {
+    page_strategy strategy;
+    b32 prefault;
+    b32 reported_fallback;
+    b32 reported_madvise_failure;
+} MemoryConfig;
+
+// Huge-page sizes are rounded up to whole pages, so DeallocateMemory can recompute the
+// mapped length from the size it is given.
+[[maybe_unused]] internal usize
+GetMappedSize(usize size)
+{
+    if (MemoryConfig.strategy == Pages_Default) {
+        return size;
+    }
+
+    return (size + HUGE_PAGE_SIZE - 1) & ~(usize)(HUGE_PAGE_SIZE - 1);
+}
+
+[[maybe_unused]] internal usize
+GetAllocationGranularity(void)
+{
+    if (MemoryConfig.strategy == Pages_Default) {
+        return (usize)sysconf(_SC_PAGESIZE);
+    }
+
+    return HUGE_PAGE_SIZE;
+}
+
+[[maybe_unused]] internal void *
+AllocateMemoryWithStrategy(usize size, page_strategy *used_strategy)
+{
+    usize mapped_size = GetMappedSize(size);
+    int flags = MAP_ANON | MAP_PRIVATE;
+    void *result = MAP_FAILED;
+
+    *used_strategy = MemoryConfig.strategy;
+
+#if defined(MAP_HUGETLB)
+    if (MemoryConfig.strategy == Pages_Explicit) {
+        int huge_flags = flags | MAP_HUGETLB;
+#if defined(MAP_POPULATE)
+        if (MemoryConfig.prefault) {
+            huge_flags |= MAP_POPULATE;
+        }
+#endif
+        result = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE, huge_flags, -1, 0);
+    }
+#endif
+
+    if (result == MAP_FAILED && MemoryConfig.strategy == Pages_Explicit) {
+        *used_strategy = Pages_Transparent;
+        if (!MemoryConfig.reported_fallback) {
+            fprintf(stderr,
+                    "memory: explicit huge pages unavailable, falling back to transparent\n");
+            MemoryConfig.reported_fallback = true;
+        }
+    }
+
+    if (result == MAP_FAILED) {
+        // THP only backs huge-page-aligned ranges, so map one page extra and trim to it.
+        b32 align = (*used_strategy == Pages_Transparent);
+        usize reserved_size = mapped_size + (align ? HUGE_PAGE_SIZE : 0);
+
+        u8 *reserved = (u8 *)mmap(NULL, reserved_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (reserved == (u8 *)MAP_FAILED) {
+            return NULL;
+        }
+
+        result = reserved;
+        if (align) {
+            usize mask = HUGE_PAGE_SIZE - 1;
+            u8 *aligned = (u8 *)(((usize)reserved + mask) & ~mask);
+            usize head = (usize)(aligned - reserved);
+            usize tail = reserved_size - head - mapped_size;
+
+            if (head) {
+                munmap(reserved, head);
+            }
+            if (tail) {
+                munmap(aligned + mapped_size, tail);
+            }
+            result = aligned;
+        }
+
+        if (*used_strategy == Pages_Transparent) {
+#if defined(MADV_HUGEPAGE)
+            if (madvise(result, mapped_size, MADV_HUGEPAGE) != 0) {
+                *used_strategy = Pages_Default;
+                if (!MemoryConfig.reported_madvise_failure) {
+                    fprintf(stderr,
+                            "memory: transparent huge pages rejected (%s), using 4 KB pages\n",
+                            strerror(errno));
+                    MemoryConfig.reported_madvise_failure = true;
+                }
+            }
+#else
+            *used_strategy = Pages_Default;
+#endif
+        }
+
+        if (MemoryConfig.prefault) {
+            u8 *bytes = (u8 *)result;
+            for (usize offset = 0; offset < mapped_size; offset += KB(4)) {
+                bytes[offset] = 0;
+            }
+        }
+    }
+
+    return result;
+}
+
+[[maybe_unused]] internal void *
+AllocateMemory(usize size)
+{
+    page_strategy used_strategy;
+    return AllocateMemoryWithStrategy(size, &used_strategy);
+}
+
+[[maybe_unused]] internal void
+DeallocateMemory(void *mem, usize size)
+{
+    if (mem) {
+        munmap(mem, GetMappedSize(size));
+    }
+}
+
+[[maybe_unused]] internal f64
+GetWallClock(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (f64)ts.tv_sec + (f64)ts.tv_nsec * 1e-9;
+}
+
+[[maybe_unused]] internal void
+SleepUntil(f64 wall_clock)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)wall_clock;
+    ts.tv_nsec = (long)((wall_clock - (f64)ts.tv_sec) * 1e9);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+#define INPUT_RECORDING_MAGIC 0x4D525753 // "SWRM"
+#define INPUT_RECORDING_VERSION 3
+
+typedef struct {
+    u32 magic;
+    u32 version;
+    u64 random_seed;
+} input_recording_header;
+
+typedef Enum(u8, replay_mode) {
+    Replay_None,
+    Replay_Recording,
+    Replay_Playback,
+};
+
+typedef struct {
+    replay_mode mode;
+    FILE *file;
+
+    u64 frame_index;
+    b32 diverged;
+
+    state_hashes hashes;
+    state_hashes expected;
+} input_replay;
+
+[[maybe_unused]] internal b32
+BeginRecording(input_replay *replay, const char *path, u64 random_seed)
+{
+    replay->file = fopen(path, "wb");
+    if (!replay->file) {
+        fprintf(stderr, "Could not open %s for recording\n", path);
+        return false;
+    }
+
+    input_recording_header header = {
+        .magic = INPUT_RECORDING_MAGIC,
+        .version = INPUT_RECORDING_VERSION,
+        .random_seed = random_seed,
+    };
+    fwrite(&header, sizeof(header), 1, replay->file);
+
+    replay->mode = Replay_Recording;
+    return true;
+}
+
+[[maybe_unused]] internal b32
+BeginPlayback(input_replay *replay, const char *path, u64 *random_seed)
+{
+    replay->file = fopen(path, "rb");
+    if (!replay->file) {
+        fprintf(stderr, "Could not open %s for playback\n", path);
+        return false;
+    }
+
+    input_recording_header header;
+    if (fread(&header, sizeof(header), 1, replay->file) != 1 ||
+        header.magic != INPUT_RECORDING_MAGIC || header.version != INPUT_RECORDING_VERSION) {
+        fprintf(stderr, "%s is not an input recording\n", path);
+        fclose(replay->file);
+        replay->file = NULL;
+        return false;
+    }
+
+    *random_seed = header.random_seed;
+    replay->mode = Replay_Playback;
+    return true;
+}
+
+[[maybe_unused]] internal void
+RecordFrame(input_replay *replay, game_input *input)
+{
+    fwrite(input, sizeof(*input), 1, replay->file);
+    fwrite(&replay->hashes.count, sizeof(replay->hashes.count), 1, replay->file);
+    fwrite(replay->hashes.values,
+           sizeof(*replay->hashes.values),
+           replay->hashes.count,
+           replay->file);
+    replay->frame_index += 1;
+}
+
+[[maybe_unused]] internal b32
+PlayBackInput(input_replay *replay, game_input *input)
+{
+    state_hashes *expected = &replay->expected;
+    if (fread(input, sizeof(*input), 1, replay->file) != 1 ||
+        fread(&expected->count, sizeof(expected->count), 1, replay->file) != 1 ||
+        expected->count > ArrayCount(expected->values) ||
+        fread(expected->values, sizeof(*expected->values), expected->count, replay->file) !=
+            expected->count) {
+        return false;
+    }
+
+    return true;
+}
+
+[[maybe_unused]] internal void
+CheckPlaybackHashes(input_replay *replay)
+{
+    state_hashes *expected = &replay->expected;
+    state_hashes *actual = &replay->hashes;
+
+    if (!replay->diverged) {
+        usize count = Max(expected->count, actual->count);
+        for (usize i = 0; i < count; ++i) {
+            if (i >= expected->count || i >= actual->count ||
+                expected->values[i] != actual->values[i]) {
+                fprintf(stderr,
+                        "Playback diverged at frame %llu in %s\n",
+                        (unsigned long long)replay->frame_index,
+                        i < actual->count ? actual->names[i] : "(missing system)");
+                replay->diverged = true;
+                break;
+            }
+        }
+    }
+
+    replay->frame_index += 1;
+}
+
+[[maybe_unused]] internal void
+EndReplay(input_replay *replay)
+{
+    if (replay->mode == Replay_Playback) {
+        fprintf(stderr,
+                "Playback finished after %llu frames%s\n",
+                (unsigned long long)replay->frame_index,
+                replay->diverged ? "" : ", no divergence");
+    }
+
+    if (replay->file) {
+        fclose(replay->file);
+        replay->file = NULL;
+    }
+
+    replay->mode = Replay_None;
+}
+
+#endif // POSIX_PLATFORM_H